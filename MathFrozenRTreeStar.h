@@ -0,0 +1,424 @@
+/***************************************************************************
+ *   MIT License
+ * Copyright (c) 2022 Mikhail Tegin
+ * michail3110@gmail.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.                  *
+ ***************************************************************************/
+
+#ifndef MATHFROZENRTREESTAR_H
+#define MATHFROZENRTREESTAR_H
+
+#include "MathRTreeStar.h"
+
+/* Неизменяемый снимок R*-дерева только для поиска. Узлы лежат в одном массиве в порядке обхода в ширину, */
+/* потомки узла занимают в нем соседние места и задаются номером первого, указателей на родителя и потомков нет. */
+/* Элементы копируются в отдельный массив в порядке листьев, их MBR хранятся только в листьях. */
+/* Структура узлов берется из исходного дерева, поэтому замораживать лучше упакованное дерево (assign, rebuild) */
+template<class DataType, class NumberType, size_t dims, size_t M>
+class MathFrozenRTreeStar
+{
+protected:
+	typedef MathRTreeStarKernels<NumberType, dims, M>		Kernels;
+	struct Node
+	{
+		typename Kernels::Bounds		childMin;		/* Границы потомков, разложенные по осям */
+		typename Kernels::Bounds		childMax;
+		size_t							first;			/* Номер первого потомка в nodes, для листа - первого элемента в objects */
+		size_t							numChildren;	/* Число потомков */
+	};
+public:
+	/* Итератор для поиска по области: путь от корня хранится в самом итераторе */
+	class const_iterator
+	{
+	public:
+								const_iterator();
+								const_iterator(const MathFrozenRTreeStar *tree, const MathMBR<NumberType, dims>& region);
+		const DataType&			operator*() const;
+		const DataType*			operator->() const;
+		void					operator++();
+		bool					operator==(const const_iterator& it) const;
+		bool					operator!=(const const_iterator& it) const;
+	private:
+		/* Положение в узле: потомки [first, first + 64) с установленными битами mask еще не пройдены */
+		struct Position
+		{
+			size_t				numNode;
+			size_t				first;
+			uint64_t			mask;
+		};
+		/* Спуститься в узел numNode */
+		void					push(size_t numNode);
+		/* Перейти к следующему элементу, пересекающемуся с region */
+		void					next();
+		const MathFrozenRTreeStar		*tree;
+		const DataType					*current;
+		std::vector<Position>			path;
+		MathMBR<NumberType, dims>		region;
+	};
+								MathFrozenRTreeStar();
+	/* Заморозить дерево rtree */
+	template <size_t m, class Allocator, class ListPolicy>
+	explicit					MathFrozenRTreeStar(const MathRTreeStar<DataType, NumberType, dims, m, M, Allocator, ListPolicy>& rtree);
+	/* Заменить содержимое замороженной копией rtree */
+	template <size_t m, class Allocator, class ListPolicy>
+	void						assign(const MathRTreeStar<DataType, NumberType, dims, m, M, Allocator, ListPolicy>& rtree);
+	/* Вызвать visitor(const DataType&) для каждого элемента, пересекающегося с областью region */
+	template <class Visitor>
+	void						query(const MathMBR<NumberType, dims>& region, Visitor&& visitor) const;
+	/* Вызвать visitor(const DataType&) для каждого элемента, MBR которого удовлетворяет objectPredicate, */
+	/* спуск в узел выполняется, если его MBR удовлетворяет nodePredicate */
+	template <class ObjectPredicate, class NodePredicate, class Visitor>
+	void						query(ObjectPredicate&& objectPredicate, NodePredicate&& nodePredicate, Visitor&& visitor) const;
+	/* Не более k элементов, ближайших к mbr, в порядке возрастания наименьшего расстояния между их MBR и mbr */
+	std::vector<const DataType*>	nearest(const MathMBR<NumberType, dims>& mbr, size_t k) const;
+	/* Получение итератора на поиск по области region */
+	const_iterator				begin(const MathMBR<NumberType, dims>& region) const;
+	/* Получение конечного итератора поиска */
+	const_iterator				end() const;
+	/* Перебор всех элементов в порядке листьев */
+	typename std::vector<DataType>::const_iterator	cbegin() const {return objects.cbegin();}
+	typename std::vector<DataType>::const_iterator	cend() const {return objects.cend();}
+	/* Возвращает число уровней дерева */
+	size_t						levels() const {return numLevels;}
+	/* Возвращает число элементов */
+	size_t						size() const {return objects.size();}
+	/* Контейнер пуст? */
+	bool						empty() const {return objects.empty();}
+	/* Очистка дерева */
+	void						clear();
+	/* Байт, занятых узлами и элементами */
+	size_t						memory_usage() const;
+protected:
+	template <class Visitor>
+	void						queryNode(size_t numNode, const MathMBR<NumberType, dims>& region, Visitor& visitor) const;
+	template <class ObjectPredicate, class NodePredicate, class Visitor>
+	void						queryNode(size_t numNode, ObjectPredicate& objectPredicate, NodePredicate& nodePredicate, Visitor& visitor) const;
+	static MathMBR<NumberType, dims>	getChildMBR(const Node& node, size_t numChild);
+	/* Квадрат наименьшего расстояния от потомка numChild до mbr, как MathMBR::minDistance */
+	static NumberType			getMinDistance(const Node& node, size_t numChild, const MathMBR<NumberType, dims>& mbr);
+	std::vector<Node>			nodes;				/* Узлы в порядке обхода в ширину, корень - первый */
+	std::vector<DataType>		objects;			/* Элементы в порядке листьев */
+	size_t						firstLeaf;			/* Номер первого листа */
+	size_t						numLevels;			/* Число уровней в дереве */
+};
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator::const_iterator(): tree(nullptr), current(nullptr)
+{
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator::const_iterator(const MathFrozenRTreeStar *tree, const MathMBR<NumberType, dims>& region):
+	tree(tree), current(nullptr), region(region)
+{
+	/* пустая область ни с чем не пересекается */
+	if(tree->nodes.empty() || region == MathMBR<NumberType, dims>()) return;
+	path.reserve(tree->numLevels);
+	push(0);
+	next();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+const DataType& MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator::operator*() const
+{
+	return *current;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+const DataType* MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator::operator->() const
+{
+	return current;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+void MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator::operator++()
+{
+	if(current != nullptr)
+		next();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+bool MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator::operator==(const const_iterator& it) const
+{
+	return current == it.current;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+bool MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator::operator!=(const const_iterator& it) const
+{
+	return current != it.current;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+void MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator::push(size_t numNode)
+{
+	const Node		&node = tree->nodes[numNode];
+
+	path.push_back({numNode, 0, Kernels::intersect(node.childMin, node.childMax, 0, node.numChildren, region)});
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+void MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator::next()
+{
+	while(!path.empty())
+	{
+		Position		&position = path.back();
+		const Node		&node = tree->nodes[position.numNode];
+
+		if(position.mask == 0)
+		{
+			/* следующая группа из 64 потомков или подъем к родителю */
+			position.first += 64;
+			if(position.first < node.numChildren)
+				position.mask = Kernels::intersect(node.childMin, node.childMax, position.first, node.numChildren, region);
+			else
+				path.pop_back();
+			continue;
+		}
+
+		size_t			numChild = node.first + position.first + Kernels::firstBit(position.mask);
+
+		position.mask &= position.mask - 1;
+		if(position.numNode >= tree->firstLeaf)
+		{
+			current = &tree->objects[numChild];
+			return;
+		}
+		push(numChild);
+	}
+	current = nullptr;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+MathFrozenRTreeStar<DataType, NumberType, dims, M>::MathFrozenRTreeStar(): firstLeaf(0), numLevels(0)
+{
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+template <size_t m, class Allocator, class ListPolicy>
+MathFrozenRTreeStar<DataType, NumberType, dims, M>::MathFrozenRTreeStar(const MathRTreeStar<DataType, NumberType, dims, m, M, Allocator, ListPolicy>& rtree): firstLeaf(0), numLevels(0)
+{
+	assign(rtree);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+template <size_t m, class Allocator, class ListPolicy>
+void MathFrozenRTreeStar<DataType, NumberType, dims, M>::assign(const MathRTreeStar<DataType, NumberType, dims, m, M, Allocator, ListPolicy>& rtree)
+{
+	typedef MathRTreeStar<DataType, NumberType, dims, m, M, Allocator, ListPolicy>	RTreeType;
+
+	clear();
+	if(rtree.getTop() == nullptr || rtree.empty()) return;
+	objects.reserve(rtree.size());
+	numLevels = rtree.levels();
+
+	/* уровни переносятся по очереди: потомки узлов уровня попадают в следующий уровень подряд */
+	std::vector<const typename RTreeType::Node*>		level(1, rtree.getTop()), nextLevel;
+
+	while(!level.empty())
+	{
+		size_t		nextFirst = nodes.size() + level.size();
+
+		if(level.front()->isLeaf())
+			firstLeaf = nodes.size();
+		for(auto source : level)
+		{
+			nodes.emplace_back();
+
+			Node		&node = nodes.back();
+
+			node.numChildren = source->getNumChildren();
+			node.first = source->isLeaf() ? objects.size() : nextFirst + nextLevel.size();
+			for(size_t i = 0; i < node.numChildren; i++)
+			{
+				MathMBR<NumberType, dims>		childMBR = source->getChildMBR(i);
+
+				for(size_t j = 0; j < dims; j++)
+				{
+					node.childMin[j][i] = childMBR.minDim(j);
+					node.childMax[j][i] = childMBR.maxDim(j);
+				}
+				if(source->isLeaf())
+					objects.push_back(static_cast<const typename RTreeType::DataNode*>(source->childs[i])->data);
+				else
+					nextLevel.push_back(static_cast<const typename RTreeType::Node*>(source->childs[i]));
+			}
+		}
+		level.swap(nextLevel);
+		nextLevel.clear();
+	}
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+template <class Visitor>
+void MathFrozenRTreeStar<DataType, NumberType, dims, M>::query(const MathMBR<NumberType, dims>& region, Visitor&& visitor) const
+{
+	if(nodes.empty() || region == MathMBR<NumberType, dims>()) return;
+	queryNode(0, region, visitor);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+template <class ObjectPredicate, class NodePredicate, class Visitor>
+void MathFrozenRTreeStar<DataType, NumberType, dims, M>::query(ObjectPredicate&& objectPredicate, NodePredicate&& nodePredicate, Visitor&& visitor) const
+{
+	if(nodes.empty()) return;
+	queryNode(0, objectPredicate, nodePredicate, visitor);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+std::vector<const DataType*> MathFrozenRTreeStar<DataType, NumberType, dims, M>::nearest(const MathMBR<NumberType, dims>& mbr, size_t k) const
+{
+	/* кандидат - узел или элемент с наименьшим расстоянием до mbr */
+	struct Candidate
+	{
+		NumberType			distance;
+		size_t				num;
+		bool				isObject;
+		/* при равных расстояниях элементы выдаются раньше узлов */
+		bool				operator<(const Candidate& candidate) const
+		{
+			if(distance != candidate.distance) return distance > candidate.distance;
+			return !isObject && candidate.isObject;
+		}
+	};
+	std::vector<const DataType*>			result;
+	std::priority_queue<Candidate>			candidates;
+
+	if(nodes.empty() || k == 0) return result;
+	result.reserve(std::min(k, objects.size()));
+	/* обход по возрастанию расстояния: элемент, извлеченный из очереди, ближе всех непросмотренных */
+	candidates.push({NumberType(0), 0, false});
+	while(!candidates.empty() && result.size() < k)
+	{
+		Candidate		candidate = candidates.top();
+
+		candidates.pop();
+		if(candidate.isObject)
+		{
+			result.push_back(&objects[candidate.num]);
+			continue;
+		}
+
+		const Node		&node = nodes[candidate.num];
+		bool			isLeaf = candidate.num >= firstLeaf;
+
+		for(size_t i = 0; i < node.numChildren; i++)
+			candidates.push({getMinDistance(node, i, mbr), node.first + i, isLeaf});
+	}
+	return result;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+typename MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator MathFrozenRTreeStar<DataType, NumberType, dims, M>::begin(const MathMBR<NumberType, dims>& region) const
+{
+	return const_iterator(this, region);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+typename MathFrozenRTreeStar<DataType, NumberType, dims, M>::const_iterator MathFrozenRTreeStar<DataType, NumberType, dims, M>::end() const
+{
+	return const_iterator();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+void MathFrozenRTreeStar<DataType, NumberType, dims, M>::clear()
+{
+	nodes.clear();
+	nodes.shrink_to_fit();
+	objects.clear();
+	objects.shrink_to_fit();
+	firstLeaf = 0;
+	numLevels = 0;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+size_t MathFrozenRTreeStar<DataType, NumberType, dims, M>::memory_usage() const
+{
+	return nodes.capacity() * sizeof(Node) + objects.capacity() * sizeof(DataType);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+template <class Visitor>
+void MathFrozenRTreeStar<DataType, NumberType, dims, M>::queryNode(size_t numNode, const MathMBR<NumberType, dims>& region, Visitor& visitor) const
+{
+	const Node		&node = nodes[numNode];
+
+	/* потомки проверяются группами по 64 */
+	for(size_t first = 0; first < node.numChildren; first += 64)
+		for(uint64_t mask = Kernels::intersect(node.childMin, node.childMax, first, node.numChildren, region); mask != 0; mask &= mask - 1)
+		{
+			size_t		num = node.first + first + Kernels::firstBit(mask);
+
+			if(numNode >= firstLeaf)
+				visitor(objects[num]);
+			else
+				queryNode(num, region, visitor);
+		}
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+template <class ObjectPredicate, class NodePredicate, class Visitor>
+void MathFrozenRTreeStar<DataType, NumberType, dims, M>::queryNode(size_t numNode, ObjectPredicate& objectPredicate, NodePredicate& nodePredicate, Visitor& visitor) const
+{
+	const Node		&node = nodes[numNode];
+
+	if(numNode >= firstLeaf)
+	{
+		for(size_t i = 0; i < node.numChildren; i++)
+			if(objectPredicate(getChildMBR(node, i)))
+				visitor(objects[node.first + i]);
+	}
+	else
+		for(size_t i = 0; i < node.numChildren; i++)
+			if(nodePredicate(getChildMBR(node, i)))
+				queryNode(node.first + i, objectPredicate, nodePredicate, visitor);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+MathMBR<NumberType, dims> MathFrozenRTreeStar<DataType, NumberType, dims, M>::getChildMBR(const Node& node, size_t numChild)
+{
+	MathMBR<NumberType, dims>	childMBR;
+
+	for(size_t i = 0; i < dims; i++)
+		childMBR.setDim(node.childMin[i][numChild], node.childMax[i][numChild], i);
+	return childMBR;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t M>
+NumberType MathFrozenRTreeStar<DataType, NumberType, dims, M>::getMinDistance(const Node& node, size_t numChild, const MathMBR<NumberType, dims>& mbr)
+{
+	NumberType		ret = NumberType(0);
+
+	for(size_t i = 0; i < dims; i++)
+	{
+		NumberType		delta;
+
+		if(mbr.maxDim(i) < node.childMin[i][numChild])
+			delta = node.childMin[i][numChild] - mbr.maxDim(i);
+		else if(node.childMax[i][numChild] < mbr.minDim(i))
+			delta = mbr.minDim(i) - node.childMax[i][numChild];
+		else
+			continue;
+		ret += delta*delta;
+	}
+	return ret;
+}
+
+#endif // MATHFROZENRTREESTAR_H
@@ -42,8 +42,9 @@ public:
 		std::string				errString;
 	};
 							MathMBR();
-							MathMBR(const MathMBR& mbr);
-							MathMBR(MathMBR&& mbr);
+	/* Копирование по умолчанию: MBR из тривиально копируемых чисел сам тривиально копируем (см. MathRTreeStar::assign_external) */
+							MathMBR(const MathMBR& mbr) = default;
+							MathMBR(MathMBR&& mbr) = default;
 	void					clear();
 	void					setDim(const NumberType& min, const NumberType& max, const size_t& numDim);
 	const NumberType&		minDim(const size_t& numDim) const;
@@ -55,11 +56,12 @@ public:
 	bool					isInside(const MathMBR& mbr) const;
 	bool					isInside(const NumberType& key, const size_t& numDim) const;
 	bool					operator==(const MathMBR& mbr) const;
-	void					operator=(const MathMBR& mbr);
-	void					operator=(MathMBR&& mbr);
+	MathMBR&				operator=(const MathMBR& mbr) = default;
+	MathMBR&				operator=(MathMBR&& mbr) = default;
 	NumberType				volume() const;
 	NumberType				perimeter() const;
 	NumberType				distance(const MathMBR& mbr) const;
+	NumberType				minDistance(const MathMBR& mbr) const;
 	NumberType				overlapVolume(const MathMBR& mbr) const;
 	NumberType				unionVolume(const MathMBR& mbr) const;
 private:
@@ -78,28 +80,6 @@ MathMBR<NumberType, dims>::MathMBR(): isEmpty(true)
 	}
 }
 
-template<class NumberType, size_t dims>
-MathMBR<NumberType, dims>::MathMBR(const MathMBR& mbr)
-{
-	if(!mbr.isEmpty)
-		for(size_t i = 0; i < dims; i++) {
-			min[i] = mbr.min[i];
-			max[i] = mbr.max[i];
-		}
-	isEmpty = mbr.isEmpty;
-}
-
-template<class NumberType, size_t dims>
-MathMBR<NumberType, dims>::MathMBR(MathMBR&& mbr)
-{
-	if(!mbr.isEmpty)
-		for(size_t i = 0; i < dims; i++) {
-			min[i] = std::move(mbr.min[i]);
-			max[i] = std::move(mbr.max[i]);
-		}
-	isEmpty = mbr.isEmpty;
-}
-
 template<class NumberType, size_t dims>
 void MathMBR<NumberType, dims>::clear()
 {
@@ -254,28 +234,6 @@ bool MathMBR<NumberType, dims>::operator==(const MathMBR& mbr) const
 	return true;
 }
 
-template<class NumberType, size_t dims>
-void MathMBR<NumberType, dims>::operator=(const MathMBR& mbr)
-{
-	if (!mbr.isEmpty)
-		for (size_t i = 0; i < dims; i++) {
-			min[i] = mbr.min[i];
-			max[i] = mbr.max[i];
-		}
-	isEmpty = mbr.isEmpty;
-}
-
-template<class NumberType, size_t dims>
-void MathMBR<NumberType, dims>::operator=(MathMBR&& mbr)
-{
-	if (!mbr.isEmpty)
-		for (size_t i = 0; i < dims; i++) {
-			min[i] = std::move(mbr.min[i]);
-			max[i] = std::move(mbr.max[i]);
-		}
-	isEmpty = mbr.isEmpty;
-}
-
 template<class NumberType, size_t dims>
 NumberType MathMBR<NumberType, dims>::volume() const
 {
@@ -320,6 +278,30 @@ NumberType MathMBR<NumberType, dims>::distance(const MathMBR& mbr) const
 	return std::move(ret/NumberType(4));
 }
 
+template<class NumberType, size_t dims>
+NumberType MathMBR<NumberType, dims>::minDistance(const MathMBR& mbr) const
+{
+#ifdef MATH_RTREE_STAR_MBR_DEBUG
+	if (isEmpty || mbr.isEmpty)
+		throw Exception("Empty MBR hasn't spatial location");
+#endif
+	NumberType	ret = NumberType(0);
+
+	for (size_t i = 0; i < dims; i++) {
+		NumberType		delta;
+
+		if (mbr.max[i] < min[i])
+			delta = min[i] - mbr.max[i];
+		else if (max[i] < mbr.min[i])
+			delta = mbr.min[i] - max[i];
+		else
+			continue;
+		ret += delta*delta;
+	}
+
+	return ret;
+}
+
 template<class NumberType, size_t dims>
 NumberType MathMBR<NumberType, dims>::overlapVolume(const MathMBR& mbr) const
 {
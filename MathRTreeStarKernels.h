@@ -0,0 +1,490 @@
+/***************************************************************************
+ *   MIT License
+ * Copyright (c) 2022 Mikhail Tegin
+ * michail3110@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.                  *
+ ***************************************************************************/
+
+#ifndef MATHRTREESTARKERNELS_H
+#define MATHRTREESTARKERNELS_H
+
+#include <stddef.h>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include "MathMBR.h"
+
+//#define	MATH_RTREE_STAR_NO_SIMD				/* Не использовать векторные ядра, только скалярную реализацию */
+
+#if !defined(MATH_RTREE_STAR_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define MATH_RTREE_STAR_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+/* Ядра проверки потомков узла R*-дерева. Границы потомков хранятся по осям: childMin[dims][M], childMax[dims][M]. */
+/* Для float, double и беззнаковых 8- и 16-битных границ на x86-64 при первом вызове по возможностям процессора */
+/* выбирается реализация для AVX2 или SSE2, */
+/* для остальных типов и платформ - скалярная. Векторные ядра считают объемы в том же порядке операций, что и MathMBR, */
+/* поэтому результаты, а значит и структура дерева, от набора команд не зависят. Пересечение с узлами меньше */
+/* scalarChildren потомков проверяется встроенным скалярным ядром: на таких узлах вызов через таблицу и проверка */
+/* инициализации выбора дороже самой проверки */
+template<class NumberType, size_t dims, size_t M>
+class MathRTreeStarKernels
+{
+public:
+	typedef NumberType			Bounds[dims][M];
+	/* Число потомков, начиная с которого пересечение проверяется векторным ядром */
+	static const size_t			scalarChildren = 32;
+	/* Битовая маска потомков [first, min(last, first + 64)), пересекающихся с непустой region: бит i - потомок first + i */
+	static uint64_t				intersect(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region);
+	/* Объемы потомков [0, num) и объемы их объединений с непустой mbr */
+	static void					volumes(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+										NumberType *unionVolumes, NumberType *childVolumes);
+	/* Объемы пересечений потомков [0, num) с непустой mbr */
+	static void					overlaps(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr, NumberType *overlapVolumes);
+	/* Скалярные реализации тех же ядер */
+	static uint64_t				intersectScalar(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region);
+	static void					volumesScalar(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+											  NumberType *unionVolumes, NumberType *childVolumes);
+	static void					overlapsScalar(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr, NumberType *overlapVolumes);
+	/* Набор команд, выбранный для ядер */
+	static const char*			instructionSet();
+	/* Номер младшего установленного бита непустой маски */
+	static size_t				firstBit(uint64_t mask);
+private:
+	struct Table
+	{
+		uint64_t				(*intersect)(const Bounds&, const Bounds&, size_t, size_t, const MathMBR<NumberType, dims>&);
+		void					(*volumes)(const Bounds&, const Bounds&, size_t, const MathMBR<NumberType, dims>&, NumberType*, NumberType*);
+		void					(*overlaps)(const Bounds&, const Bounds&, size_t, const MathMBR<NumberType, dims>&, NumberType*);
+		const char				*name;
+	};
+	static const Table&			table();
+	static Table				select(std::false_type);
+	static void					volumesRange(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& mbr,
+											 NumberType *unionVolumes, NumberType *childVolumes);
+	static void					overlapsRange(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& mbr,
+											  NumberType *overlapVolumes);
+#ifdef MATH_RTREE_STAR_SIMD_X86
+	static Table				select(std::true_type);
+	/* Ширина вектора width элементов, ядра встраиваются в функции, скомпилированные для нужного набора команд */
+	template <size_t width>
+	struct Vector
+	{
+		typedef NumberType		Type __attribute__((vector_size(width * sizeof(NumberType))));
+		static void				load(Type& vector, const NumberType *data) __attribute__((always_inline));
+		static void				fill(Type& vector, const NumberType& value) __attribute__((always_inline));
+		/* Знаковые биты результата сравнения векторов, собираемые по 16 байт командами SSE2 */
+		template <class Result>
+		static uint64_t			signMask(const Result& result) __attribute__((always_inline));
+	};
+	template <size_t width>
+	static uint64_t				intersectVector(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region)
+																																	__attribute__((always_inline));
+	/* Остаток потомков, не заполняющий вектор width: векторами вдвое короче, пока они не короче 16 байт, затем поэлементно */
+	template <size_t width>
+	static uint64_t				intersectRest(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region,
+											  std::true_type) __attribute__((always_inline));
+	template <size_t width>
+	static uint64_t				intersectRest(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region,
+											  std::false_type) __attribute__((always_inline));
+	template <size_t width>
+	static void					volumesVector(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+											  NumberType *unionVolumes, NumberType *childVolumes) __attribute__((always_inline));
+	template <size_t width>
+	static void					overlapsVector(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+											   NumberType *overlapVolumes) __attribute__((always_inline));
+	static uint64_t				intersectSSE2(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region);
+	static void					volumesSSE2(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+											NumberType *unionVolumes, NumberType *childVolumes);
+	static void					overlapsSSE2(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr, NumberType *overlapVolumes);
+	__attribute__((target("avx2")))
+	static uint64_t				intersectAVX2(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region);
+	__attribute__((target("avx2")))
+	static void					volumesAVX2(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+											NumberType *unionVolumes, NumberType *childVolumes);
+	__attribute__((target("avx2")))
+	static void					overlapsAVX2(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr, NumberType *overlapVolumes);
+#endif
+};
+
+template<class NumberType, size_t dims, size_t M>
+uint64_t MathRTreeStarKernels<NumberType, dims, M>::intersect(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region)
+{
+	if(M < scalarChildren)
+		return intersectScalar(childMin, childMax, first, last, region);
+	return table().intersect(childMin, childMax, first, last, region);
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::volumes(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+														NumberType *unionVolumes, NumberType *childVolumes)
+{
+	table().volumes(childMin, childMax, num, mbr, unionVolumes, childVolumes);
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::overlaps(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr, NumberType *overlapVolumes)
+{
+	table().overlaps(childMin, childMax, num, mbr, overlapVolumes);
+}
+
+template<class NumberType, size_t dims, size_t M>
+uint64_t MathRTreeStarKernels<NumberType, dims, M>::intersectScalar(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region)
+{
+	uint64_t		mask = 0;
+
+	last = std::min(last, first + 64);
+	for(size_t i = first; i < last; i++)
+	{
+		bool		isIntersect = true;
+
+		for(size_t j = 0; j < dims && isIntersect; j++)
+			isIntersect = region.minDim(j) <= childMax[j][i] && region.maxDim(j) >= childMin[j][i];
+		if(isIntersect) mask |= uint64_t(1) << (i - first);
+	}
+	return mask;
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::volumesScalar(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+															  NumberType *unionVolumes, NumberType *childVolumes)
+{
+	volumesRange(childMin, childMax, 0, num, mbr, unionVolumes, childVolumes);
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::overlapsScalar(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr, NumberType *overlapVolumes)
+{
+	overlapsRange(childMin, childMax, 0, num, mbr, overlapVolumes);
+}
+
+template<class NumberType, size_t dims, size_t M>
+const char* MathRTreeStarKernels<NumberType, dims, M>::instructionSet()
+{
+	return table().name;
+}
+
+template<class NumberType, size_t dims, size_t M>
+size_t MathRTreeStarKernels<NumberType, dims, M>::firstBit(uint64_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return size_t(__builtin_ctzll(mask));
+#else
+	size_t		num = 0;
+
+	for(; (mask & 1) == 0; mask >>= 1)
+		num++;
+	return num;
+#endif
+}
+
+template<class NumberType, size_t dims, size_t M>
+const typename MathRTreeStarKernels<NumberType, dims, M>::Table& MathRTreeStarKernels<NumberType, dims, M>::table()
+{
+#ifdef MATH_RTREE_STAR_SIMD_X86
+	static const Table		selected = select(std::integral_constant<bool, std::is_same<NumberType, float>::value || std::is_same<NumberType, double>::value ||
+																		  std::is_same<NumberType, uint8_t>::value || std::is_same<NumberType, uint16_t>::value>());
+#else
+	static const Table		selected = select(std::false_type());
+#endif
+	return selected;
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::volumesRange(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& mbr,
+															 NumberType *unionVolumes, NumberType *childVolumes)
+{
+	/* порядок операций совпадает с MathMBR::unionVolume и MathMBR::volume */
+	for(size_t i = first; i < last; i++)
+	{
+		NumberType		unionVolume = std::max(mbr.maxDim(0), childMax[0][i]) - std::min(mbr.minDim(0), childMin[0][i]);
+		NumberType		childVolume = childMax[0][i] - childMin[0][i];
+
+		for(size_t j = 1; j < dims; j++)
+		{
+			unionVolume *= std::max(mbr.maxDim(j), childMax[j][i]) - std::min(mbr.minDim(j), childMin[j][i]);
+			childVolume *= childMax[j][i] - childMin[j][i];
+		}
+		unionVolumes[i] = unionVolume;
+		childVolumes[i] = childVolume;
+	}
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::overlapsRange(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& mbr,
+															  NumberType *overlapVolumes)
+{
+	/* порядок операций совпадает с MathMBR::overlapVolume */
+	for(size_t i = first; i < last; i++)
+	{
+		NumberType		overlapVolume = NumberType(0);
+
+		for(size_t j = 0; j < dims; j++)
+		{
+			NumberType		min = std::max(mbr.minDim(j), childMin[j][i]);
+			NumberType		max = std::min(mbr.maxDim(j), childMax[j][i]);
+
+			if(min >= max)
+			{
+				overlapVolume = NumberType(0);
+				break;
+			}
+			overlapVolume = j == 0 ? max - min : overlapVolume * (max - min);
+		}
+		overlapVolumes[i] = overlapVolume;
+	}
+}
+
+template<class NumberType, size_t dims, size_t M>
+typename MathRTreeStarKernels<NumberType, dims, M>::Table MathRTreeStarKernels<NumberType, dims, M>::select(std::false_type)
+{
+	return Table{&intersectScalar, &volumesScalar, &overlapsScalar, "scalar"};
+}
+
+#ifdef MATH_RTREE_STAR_SIMD_X86
+template<class NumberType, size_t dims, size_t M>
+typename MathRTreeStarKernels<NumberType, dims, M>::Table MathRTreeStarKernels<NumberType, dims, M>::select(std::true_type)
+{
+	/* SSE2 есть на любом x86-64 процессоре. На процессорах с AVX-512 используются ядра AVX2: сравнения векторов */
+	/* в регистры масок AVX-512 через векторные расширения GCC компилируются поэлементно */
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return Table{&intersectAVX2, &volumesAVX2, &overlapsAVX2, "AVX2"};
+	return Table{&intersectSSE2, &volumesSSE2, &overlapsSSE2, "SSE2"};
+}
+
+template<class NumberType, size_t dims, size_t M>
+template <size_t width>
+inline void MathRTreeStarKernels<NumberType, dims, M>::Vector<width>::load(Type& vector, const NumberType *data)
+{
+	std::memcpy(&vector, data, sizeof(vector));
+}
+
+template<class NumberType, size_t dims, size_t M>
+template <size_t width>
+inline void MathRTreeStarKernels<NumberType, dims, M>::Vector<width>::fill(Type& vector, const NumberType& value)
+{
+	for(size_t i = 0; i < width; i++)
+		vector[i] = value;
+}
+
+template<class NumberType, size_t dims, size_t M>
+template <size_t width>
+template <class Result>
+inline uint64_t MathRTreeStarKernels<NumberType, dims, M>::Vector<width>::signMask(const Result& result)
+{
+	const size_t			step = 16 / sizeof(NumberType);
+	uint64_t				mask = 0;
+
+	for(size_t i = 0; i < width; i += step)
+	{
+		__m128i				part;
+		int					partMask;
+
+		std::memcpy(&part, reinterpret_cast<const char*>(&result) + i * sizeof(NumberType), sizeof(part));
+		switch(sizeof(NumberType))
+		{
+		case 8:
+			partMask = _mm_movemask_pd(_mm_castsi128_pd(part));
+			break;
+		case 4:
+			partMask = _mm_movemask_ps(_mm_castsi128_ps(part));
+			break;
+		case 2:
+			/* элементы сравнения равны 0 или -1 и сохраняются при упаковке в байты */
+			partMask = _mm_movemask_epi8(_mm_packs_epi16(part, _mm_setzero_si128()));
+			break;
+		default:
+			partMask = _mm_movemask_epi8(part);
+		}
+		mask |= uint64_t(unsigned(partMask)) << i;
+	}
+	return mask;
+}
+
+template<class NumberType, size_t dims, size_t M>
+template <size_t width>
+inline uint64_t MathRTreeStarKernels<NumberType, dims, M>::intersectVector(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last,
+																		   const MathMBR<NumberType, dims>& region)
+{
+	typedef Vector<width>								V;
+	typename V::Type									regionMin[dims], regionMax[dims];
+	uint64_t											mask = 0;
+	size_t												i = first;
+
+	last = std::min(last, first + 64);
+	for(size_t j = 0; j < dims; j++)
+	{
+		V::fill(regionMin[j], region.minDim(j));
+		V::fill(regionMax[j], region.maxDim(j));
+	}
+	for(; i + width <= last; i += width)
+	{
+		typename V::Type		min, max;
+
+		V::load(min, &childMin[0][i]);
+		V::load(max, &childMax[0][i]);
+		auto					isIntersect = (regionMin[0] <= max) & (regionMax[0] >= min);
+
+		for(size_t j = 1; j < dims; j++)
+		{
+			V::load(min, &childMin[j][i]);
+			V::load(max, &childMax[j][i]);
+			isIntersect &= (regionMin[j] <= max) & (regionMax[j] >= min);
+		}
+		mask |= V::signMask(isIntersect) << (i - first);
+	}
+	if(i < last) mask |= intersectRest<width>(childMin, childMax, i, last, region, std::integral_constant<bool, (width > 16 / sizeof(NumberType))>()) << (i - first);
+	return mask;
+}
+
+template<class NumberType, size_t dims, size_t M>
+template <size_t width>
+inline uint64_t MathRTreeStarKernels<NumberType, dims, M>::intersectRest(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last,
+																		 const MathMBR<NumberType, dims>& region, std::true_type)
+{
+	return intersectVector<width / 2>(childMin, childMax, first, last, region);
+}
+
+template<class NumberType, size_t dims, size_t M>
+template <size_t width>
+inline uint64_t MathRTreeStarKernels<NumberType, dims, M>::intersectRest(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last,
+																		 const MathMBR<NumberType, dims>& region, std::false_type)
+{
+	return intersectScalar(childMin, childMax, first, last, region);
+}
+
+template<class NumberType, size_t dims, size_t M>
+template <size_t width>
+inline void MathRTreeStarKernels<NumberType, dims, M>::volumesVector(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+																	 NumberType *unionVolumes, NumberType *childVolumes)
+{
+	typedef Vector<width>								V;
+	typename V::Type									mbrMin[dims], mbrMax[dims];
+	size_t												i = 0;
+
+	for(size_t j = 0; j < dims; j++)
+	{
+		V::fill(mbrMin[j], mbr.minDim(j));
+		V::fill(mbrMax[j], mbr.maxDim(j));
+	}
+	for(; i + width <= num; i += width)
+	{
+		typename V::Type		min, max;
+
+		V::load(min, &childMin[0][i]);
+		V::load(max, &childMax[0][i]);
+		typename V::Type		unionVolume = (mbrMax[0] > max ? mbrMax[0] : max) - (mbrMin[0] < min ? mbrMin[0] : min);
+		typename V::Type		childVolume = max - min;
+
+		for(size_t j = 1; j < dims; j++)
+		{
+			V::load(min, &childMin[j][i]);
+			V::load(max, &childMax[j][i]);
+			unionVolume *= (mbrMax[j] > max ? mbrMax[j] : max) - (mbrMin[j] < min ? mbrMin[j] : min);
+			childVolume *= max - min;
+		}
+		std::memcpy(unionVolumes + i, &unionVolume, sizeof(unionVolume));
+		std::memcpy(childVolumes + i, &childVolume, sizeof(childVolume));
+	}
+	volumesRange(childMin, childMax, i, num, mbr, unionVolumes, childVolumes);
+}
+
+template<class NumberType, size_t dims, size_t M>
+template <size_t width>
+inline void MathRTreeStarKernels<NumberType, dims, M>::overlapsVector(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+																	  NumberType *overlapVolumes)
+{
+	typedef Vector<width>								V;
+	typename V::Type									mbrMin[dims], mbrMax[dims], zero;
+	size_t												i = 0;
+
+	V::fill(zero, NumberType(0));
+	for(size_t j = 0; j < dims; j++)
+	{
+		V::fill(mbrMin[j], mbr.minDim(j));
+		V::fill(mbrMax[j], mbr.maxDim(j));
+	}
+	for(; i + width <= num; i += width)
+	{
+		typename V::Type		min, max;
+
+		V::load(min, &childMin[0][i]);
+		V::load(max, &childMax[0][i]);
+		typename V::Type		overlapMin = mbrMin[0] > min ? mbrMin[0] : min;
+		typename V::Type		overlapMax = mbrMax[0] < max ? mbrMax[0] : max;
+		/* объем без пересечения по какой-либо оси равен нулю */
+		typename V::Type		overlapVolume = overlapMin < overlapMax ? overlapMax - overlapMin : zero;
+
+		for(size_t j = 1; j < dims; j++)
+		{
+			V::load(min, &childMin[j][i]);
+			V::load(max, &childMax[j][i]);
+			overlapMin = mbrMin[j] > min ? mbrMin[j] : min;
+			overlapMax = mbrMax[j] < max ? mbrMax[j] : max;
+			overlapVolume = overlapMin < overlapMax ? overlapVolume * (overlapMax - overlapMin) : zero;
+		}
+		std::memcpy(overlapVolumes + i, &overlapVolume, sizeof(overlapVolume));
+	}
+	overlapsRange(childMin, childMax, i, num, mbr, overlapVolumes);
+}
+
+template<class NumberType, size_t dims, size_t M>
+uint64_t MathRTreeStarKernels<NumberType, dims, M>::intersectSSE2(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region)
+{
+	return intersectVector<16 / sizeof(NumberType)>(childMin, childMax, first, last, region);
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::volumesSSE2(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+															NumberType *unionVolumes, NumberType *childVolumes)
+{
+	volumesVector<16 / sizeof(NumberType)>(childMin, childMax, num, mbr, unionVolumes, childVolumes);
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::overlapsSSE2(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr, NumberType *overlapVolumes)
+{
+	overlapsVector<16 / sizeof(NumberType)>(childMin, childMax, num, mbr, overlapVolumes);
+}
+
+template<class NumberType, size_t dims, size_t M>
+uint64_t MathRTreeStarKernels<NumberType, dims, M>::intersectAVX2(const Bounds& childMin, const Bounds& childMax, size_t first, size_t last, const MathMBR<NumberType, dims>& region)
+{
+	return intersectVector<32 / sizeof(NumberType)>(childMin, childMax, first, last, region);
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::volumesAVX2(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr,
+															NumberType *unionVolumes, NumberType *childVolumes)
+{
+	volumesVector<32 / sizeof(NumberType)>(childMin, childMax, num, mbr, unionVolumes, childVolumes);
+}
+
+template<class NumberType, size_t dims, size_t M>
+void MathRTreeStarKernels<NumberType, dims, M>::overlapsAVX2(const Bounds& childMin, const Bounds& childMax, size_t num, const MathMBR<NumberType, dims>& mbr, NumberType *overlapVolumes)
+{
+	overlapsVector<32 / sizeof(NumberType)>(childMin, childMax, num, mbr, overlapVolumes);
+}
+#endif
+
+#endif // MATHRTREESTARKERNELS_H
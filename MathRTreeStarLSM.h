@@ -0,0 +1,482 @@
+/***************************************************************************
+ *   MIT License
+ * Copyright (c) 2022 Mikhail Tegin
+ * michail3110@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.                  *
+ ***************************************************************************/
+
+#ifndef MATHRTREESTARLSM_H
+#define MATHRTREESTARLSM_H
+
+#include <unordered_set>
+#include <future>
+#include "MathRTreeStar.h"
+
+/* Двухуровневый индекс: упакованное базовое R*-дерево только для чтения, небольшое динамическое дерево */
+/* изменений и надгробия удаленных из базы элементов. Изменения периодически сливаются в заново упакованную */
+/* базу в фоновом потоке. Элементы доступны только для чтения, т.к. база читается фоновым слиянием. */
+/* Сам контейнер не потокобезопасен: все вызовы должны выполняться из одного потока. */
+/* insert() и erase() могут завершить готовое фоновое слияние и заменить базу новой: const_iterator, полученные до вызова, */
+/* становятся недействительными. Исключение фоновой упаковки передается из вызова, завершающего слияние (merge, wait, */
+/* insert, erase); изменения и надгробия при этом возвращаются в текущие и не теряются */
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+class MathRTreeStarLSM
+{
+public:
+	typedef MathRTreeStar<DataType, NumberType, dims, m, M>			RTreeType;
+	typedef typename RTreeType::PackingMethod						PackingMethod;
+protected:
+	typedef std::unordered_set<const DataType*>						Tombstones;
+	/* R*-дерево с доступом к узлам данных для слияния */
+	class Tree : public RTreeType
+	{
+	public:
+		/* Проверить, что элемент data находится в дереве */
+		bool								contains(const DataType& data);
+		/* Упаковать в пустое дерево узлы данных деревьев first и second, кроме элементов removed, */
+		/* их узлы данных откладываются до вызова deleteDropped */
+		void								packFrom(const Tree& first, const Tree& second, const Tombstones& removed, PackingMethod method);
+		/* Удалить узлы данных, отложенные при packFrom */
+		void								deleteDropped();
+		/* Очистить дерево без удаления узлов данных, перешедших в другое дерево */
+		void								release();
+		/* Восстановить ссылки узлов данных на листья и список элементов, измененные прерванной упаковкой packFrom */
+		void								restoreLinks();
+		/* Принять пулы дерева tree, в которых лежат перешедшие узлы данных */
+		void								adopt(Tree& tree);
+	private:
+		void								collect(const Tree& tree, const Tombstones& removed, std::vector<typename RTreeType::DataNode*>& dataNodes);
+		std::vector<typename RTreeType::DataNode*>		dropped;
+	};
+public:
+	/* Итератор для поиска по базе и дереву изменений, элементы с надгробиями пропускаются */
+	class const_iterator
+	{
+	public:
+								const_iterator();
+								const_iterator(const MathRTreeStarLSM *lsm, const typename RTreeType::PredicateType& objectPredicate, const typename RTreeType::PredicateType& nodePredicate);
+		const DataType&			operator*() const;
+		const DataType*			operator->() const;
+		void					operator++();
+		bool					operator==(const const_iterator& it) const;
+		bool					operator!=(const const_iterator& it) const;
+	private:
+		/* Перейти к первому живому элементу, начиная с текущего положения */
+		void					skip();
+		const MathRTreeStarLSM							*lsm;
+		std::array<typename RTreeType::iterator, 3>		its;
+		size_t											numTree;
+	};
+	/* Слияние начинается, когда изменений и надгробий становится не меньше mergeThreshold (0 - только вызовом merge) */
+								MathRTreeStarLSM(size_t mergeThreshold = 65536, PackingMethod method = PackingMethod::STR);
+								~MathRTreeStarLSM();
+	/* Заменить содержимое упакованной базой из элементов диапазона [first, last) */
+	template <class InputIterator>
+	void						assign(InputIterator first, InputIterator last, size_t numThreads = 1);
+	/* Вставить элемент data в дерево изменений */
+	void						insert(const DataType& data);
+	/* Вставить элемент data в дерево изменений, используется семантика перемещения */
+	void						insert(DataType&& data);
+	/* Удалить элемент по ссылке data: из дерева изменений сразу, из базы - надгробием до слияния */
+	bool						erase(const DataType& data);
+	/* Начать фоновое слияние изменений и надгробий с базой, текущее слияние предварительно завершается */
+	void						merge();
+	/* Дождаться завершения фонового слияния */
+	void						wait();
+	/* Выполняется ли фоновое слияние */
+	bool						merging() const;
+	/* Очистить контейнер */
+	void						clear();
+	/* Число элементов без учета удаленных */
+	size_t						size() const;
+	/* Получение итератора на оптимизированный поиск */
+	const_iterator				begin(const typename RTreeType::PredicateType& objectPredicate, const typename RTreeType::PredicateType& nodePredicate) const;
+	/* Получение итератора на оптимизированный поиск по области region */
+	const_iterator				begin(const MathMBR<NumberType, dims>& region) const;
+	/* Получение итератора на перебор всех элементов */
+	const_iterator				begin() const;
+	/* Получение конечного итератора */
+	const_iterator				end() const;
+	/* Упакованная база */
+	const RTreeType&			getBase() const {return base;}
+	/* Дерево изменений */
+	const RTreeType&			getDelta() const {return delta;}
+protected:
+	/* Завершить слияние, если фоновая упаковка готова (или дождаться ее при wait = true) */
+	void						finish(bool wait);
+	/* Вернуть замороженные изменения и надгробия в текущие после ошибки фоновой упаковки, база остается прежней */
+	void						restore();
+	/* Начать слияние, если накопилось достаточно изменений */
+	void						update();
+	/* Удален ли элемент data дерева numTree (0 - база, 1 - замороженные изменения, 2 - изменения) */
+	bool						isDead(const DataType *data, size_t numTree) const;
+	Tree						base;				/* Упакованная база */
+	Tree						frozen;				/* Изменения, сливаемые с базой в фоне */
+	Tree						delta;				/* Текущие изменения */
+	Tree						next;				/* Новая база, упаковываемая в фоне */
+	Tombstones					frozenTombstones;	/* Надгробия, учитываемые в фоновом слиянии */
+	Tombstones					tombstones;			/* Текущие надгробия элементов базы и замороженных изменений */
+	std::future<void>			merger;				/* Фоновое слияние */
+	size_t						mergeThreshold;		/* Порог числа изменений для начала слияния */
+	PackingMethod				method;				/* Способ упаковки базы */
+};
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+bool MathRTreeStarLSM<DataType, NumberType, dims, m, M>::Tree::contains(const DataType& data)
+{
+	const MathMBR<NumberType, dims>	&mbrRegion = data.getMBR();
+
+	if(this->size() == 0) return false;
+	for(auto it = this->begin([&mbrRegion](const MathMBR<NumberType, dims>& mbrObjectNode){return  mbrRegion == mbrObjectNode;},
+							  [&mbrRegion](const MathMBR<NumberType, dims>& mbrListNode){return mbrListNode.isInside(mbrRegion);}); it != this->end(); ++it)
+		if(&*it == &data) return true;
+	return false;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::Tree::collect(const Tree& tree, const Tombstones& removed, std::vector<typename RTreeType::DataNode*>& dataNodes)
+{
+	/* обход по листьям читает только внутренние узлы, которые основной поток не изменяет */
+	for(auto node = RTreeType::firstLeaf(tree.root); node != nullptr; node = RTreeType::nextInThisRow(node))
+		for(size_t i = 0; i < node->getNumChildren(); i++)
+		{
+			auto	dataNode = static_cast<typename RTreeType::DataNode*>(node->childs[i]);
+
+			if(removed.count(&dataNode->data) != 0) dropped.push_back(dataNode);
+			else dataNodes.push_back(dataNode);
+		}
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::Tree::packFrom(const Tree& first, const Tree& second, const Tombstones& removed, PackingMethod method)
+{
+	std::vector<typename RTreeType::DataNode*>		dataNodes;
+
+	dataNodes.reserve(first.size() + second.size());
+	collect(first, removed, dataNodes);
+	collect(second, removed, dataNodes);
+	/* упаковка изменяет только связи узлов данных, поиск в старой базе их не читает */
+	this->pack(dataNodes, method);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::Tree::deleteDropped()
+{
+	for(auto dataNode : dropped)
+		this->dataNodePool.destroy(dataNode);
+	dropped.clear();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::Tree::release()
+{
+	this->nodePool.release();
+	this->root = nullptr;
+	this->firstDataNode = nullptr;
+	this->numElements = 0;
+	this->numLevels = 0;
+	dropped.clear();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::Tree::restoreLinks()
+{
+	/* листья переприсоединяют своих потомков: узлы данных снова ссылаются на них, MBR листьев не меняются */
+	for(auto node = RTreeType::firstLeaf(this->root); node != nullptr; node = RTreeType::nextInThisRow(node))
+	{
+		std::array<typename RTreeType::DataNode*, M>	children;
+		size_t											numChildren = node->getNumChildren();
+
+		for(size_t i = 0; i < numChildren; i++)
+			children[i] = static_cast<typename RTreeType::DataNode*>(node->childs[i]);
+		node->detachAll();
+		for(size_t i = 0; i < numChildren; i++)
+			node->attach(children[i]);
+	}
+	this->linkDataNodes(typename RTreeType::IsLinked());
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::Tree::adopt(Tree& tree)
+{
+	this->nodePool.merge(tree.nodePool);
+	this->dataNodePool.merge(tree.dataNodePool);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator::const_iterator()
+{
+	lsm = nullptr;
+	numTree = its.size();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator::const_iterator(const MathRTreeStarLSM *lsm, const typename RTreeType::PredicateType& objectPredicate, const typename RTreeType::PredicateType& nodePredicate)
+{
+	const Tree		*trees[3] = {&lsm->base, &lsm->frozen, &lsm->delta};
+
+	this->lsm = lsm;
+	/* элементы деревьев не изменяются через итератор, поэтому поиск идет неконстантными итераторами деревьев */
+	for(size_t i = 0; i < its.size(); i++)
+		if(trees[i]->size() != 0)
+			its[i] = const_cast<Tree*>(trees[i])->begin(objectPredicate, nodePredicate);
+	numTree = 0;
+	skip();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+const DataType& MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator::operator*() const
+{
+	return *const_cast<typename RTreeType::iterator&>(its[numTree]);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+const DataType* MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator::operator->() const
+{
+	return &*const_cast<typename RTreeType::iterator&>(its[numTree]);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator::operator++()
+{
+	++its[numTree];
+	skip();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator::skip()
+{
+	for(; numTree < its.size(); numTree++)
+	{
+		while(its[numTree].getNode() != nullptr && lsm->isDead(&*its[numTree], numTree))
+			++its[numTree];
+		if(its[numTree].getNode() != nullptr) return;
+	}
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+bool MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator::operator==(const const_iterator& it) const
+{
+	if(numTree != it.numTree) return false;
+	return numTree == its.size() || its[numTree] == it.its[numTree];
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+bool MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator::operator!=(const const_iterator& it) const
+{
+	return !(*this == it);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+MathRTreeStarLSM<DataType, NumberType, dims, m, M>::MathRTreeStarLSM(size_t mergeThreshold, PackingMethod method)
+{
+	this->mergeThreshold = mergeThreshold;
+	this->method = method;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+MathRTreeStarLSM<DataType, NumberType, dims, m, M>::~MathRTreeStarLSM()
+{
+	/* ошибка фонового слияния не важна: содержимое все равно удаляется */
+	try
+	{
+		finish(true);
+	}
+	catch(...)
+	{
+	}
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+template <class InputIterator>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::assign(InputIterator first, InputIterator last, size_t numThreads)
+{
+	clear();
+	base.assign(first, last, method, numThreads);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::insert(const DataType& data)
+{
+	delta.insert(data);
+	update();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::insert(DataType&& data)
+{
+	delta.insert(std::move(data));
+	update();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+bool MathRTreeStarLSM<DataType, NumberType, dims, m, M>::erase(const DataType& data)
+{
+	if(delta.size() != 0 && delta.erase(const_cast<DataType&>(data)))
+	{
+		update();
+		return true;
+	}
+	if(tombstones.count(&data) != 0 || frozenTombstones.count(&data) != 0) return false;
+	/* база и замороженные изменения не изменяются до завершения слияния */
+	if(!frozen.contains(data) && !base.contains(data)) return false;
+	tombstones.insert(&data);
+	update();
+	return true;
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::merge()
+{
+	finish(true);
+	if(delta.size() == 0 && tombstones.empty()) return;
+
+	/* фоновое слияние читает базу и замороженные изменения, новые изменения накапливаются отдельно */
+	frozen = std::move(delta);
+	frozenTombstones.swap(tombstones);
+	merger = std::async(std::launch::async, [this]()
+	{
+		next.packFrom(base, frozen, frozenTombstones, method);
+	});
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::wait()
+{
+	finish(true);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+bool MathRTreeStarLSM<DataType, NumberType, dims, m, M>::merging() const
+{
+	return merger.valid();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::clear()
+{
+	/* ошибка фонового слияния не важна: содержимое все равно удаляется */
+	try
+	{
+		finish(true);
+	}
+	catch(...)
+	{
+	}
+	base.clear();
+	delta.clear();
+	tombstones.clear();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+size_t MathRTreeStarLSM<DataType, NumberType, dims, m, M>::size() const
+{
+	return base.size() + frozen.size() + delta.size() - frozenTombstones.size() - tombstones.size();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+typename MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator MathRTreeStarLSM<DataType, NumberType, dims, m, M>::begin(const typename RTreeType::PredicateType& objectPredicate, const typename RTreeType::PredicateType& nodePredicate) const
+{
+	return const_iterator(this, objectPredicate, nodePredicate);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+typename MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator MathRTreeStarLSM<DataType, NumberType, dims, m, M>::begin(const MathMBR<NumberType, dims>& region) const
+{
+	return begin([region](const MathMBR<NumberType, dims>& mbrObjectNode){return region.isIntersect(mbrObjectNode);},
+				 [region](const MathMBR<NumberType, dims>& mbrListNode){return region.isIntersect(mbrListNode);});
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+typename MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator MathRTreeStarLSM<DataType, NumberType, dims, m, M>::begin() const
+{
+	return begin([](const MathMBR<NumberType, dims>&){return true;}, [](const MathMBR<NumberType, dims>&){return true;});
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+typename MathRTreeStarLSM<DataType, NumberType, dims, m, M>::const_iterator MathRTreeStarLSM<DataType, NumberType, dims, m, M>::end() const
+{
+	return const_iterator();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::finish(bool wait)
+{
+	if(!merger.valid()) return;
+	if(!wait && merger.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+	try
+	{
+		merger.get();
+	}
+	catch(...)
+	{
+		restore();
+		throw;
+	}
+
+	/* узлы данных перешли в новую базу вместе с пулами, старые внутренние узлы удаляются, удаленные элементы освобождаются */
+	base.release();
+	frozen.release();
+	next.adopt(base);
+	next.adopt(frozen);
+	next.deleteDropped();
+	frozenTombstones.clear();
+	base = std::move(next);
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::restore()
+{
+	/* новая база бросается без удаления узлов данных, которые по-прежнему принадлежат базе и замороженным изменениям */
+	next.release();
+	base.restoreLinks();
+	frozen.restoreLinks();
+	/* надгробия элементов замороженных изменений заменяются удалением, т.к. в дереве изменений надгробия не действуют */
+	for(auto it = tombstones.begin(); it != tombstones.end();)
+		if(frozen.size() != 0 && frozen.erase(const_cast<DataType&>(**it))) it = tombstones.erase(it);
+		else ++it;
+	delta.splice(frozen);
+	tombstones.insert(frozenTombstones.begin(), frozenTombstones.end());
+	frozenTombstones.clear();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+void MathRTreeStarLSM<DataType, NumberType, dims, m, M>::update()
+{
+	finish(false);
+	if(mergeThreshold != 0 && !merger.valid() && delta.size() + tombstones.size() >= mergeThreshold)
+		merge();
+}
+
+template<class DataType, class NumberType, size_t dims, size_t m, size_t M>
+bool MathRTreeStarLSM<DataType, NumberType, dims, m, M>::isDead(const DataType *data, size_t numTree) const
+{
+	switch(numTree)
+	{
+	case 0:
+		return tombstones.count(data) != 0 || frozenTombstones.count(data) != 0;
+	case 1:
+		return tombstones.count(data) != 0;
+	default:
+		return false;
+	}
+}
+
+#endif // MATHRTREESTARLSM_H
@@ -33,18 +33,15 @@ public:
     MathVector2D(const T& x, const T& y): _x(x), _y(y) {}
 	MathVector2D(const T&& x, const T&& y): _x(std::move(x)), _y(std::move(y)) {}
     MathVector2D(): _x(0), _y(0) {}
-    MathVector2D(const MathVector2D<T> &p): _x(p._x), _y(p._y) {}
-	MathVector2D(const MathVector2D<T> &&p): _x(std::move(p._x)), _y(std::move(p._y)) {}
+    MathVector2D(const MathVector2D<T> &p) = default;
+	MathVector2D(MathVector2D<T> &&p) = default;
     template<class U>
                             operator MathVector2D<U>() const
     {
         return MathVector2D<U>(U(_x), U(_y));
     }
-    void                    operator=(const MathVector2D<T>& p)
-    {
-        _x = p._x;
-        _y = p._y;
-    }
+    MathVector2D<T>&        operator=(const MathVector2D<T>& p) = default;
+    MathVector2D<T>&        operator=(MathVector2D<T>&& p) = default;
     bool                    operator==(const MathVector2D<T>& p) const
     {
         return _x == p._x && _y == p._y;
@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# Headless benchmark of MathRTreeStar building and queries
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = RTreeBench
+TEMPLATE = app
+CONFIG += console c++17 thread
+CONFIG -= app_bundle
+
+SOURCES += \
+        main.cpp
+
+HEADERS += \
+    ../../MathRTreeStar.h \
+    ../../MathRTreeStarKernels.h \
+    ../../MathFrozenRTreeStar.h \
+    ../../MathRTreeStarLSM.h \
+    ../MathVector2D.h \
+    ../../MathMBR.h
@@ -0,0 +1,948 @@
+/***************************************************************************
+ *   MIT License
+ * Copyright (c) 2022 Mikhail Tegin
+ * michail3110@gmail.com
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.                  *
+ ***************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "../../MathRTreeStar.h"
+#include "../../MathFrozenRTreeStar.h"
+#include "../../MathRTreeStarLSM.h"
+#include "../MathVector2D.h"
+
+#define MIN_X					(-100.0)
+#define MIN_Y					(-100.0)
+#define MAX_X					(100.0)
+#define MAX_Y					(100.0)
+#define MAX_SIZE				(1.0)
+#define NUM_TRIANGLES			(1000000)
+#define NUM_CLUSTERS			(50)
+#define NUM_QUERIES				(10000)
+#define QUERY_SIZE				(2.0)
+#define INSERT_BATCH			(100000)
+#define EXTERNAL_BUDGET			(16 << 20)
+#define EXTERNAL_TEMP_DIR		"."
+#define TILES_PER_SIDE			(16)
+#define CHECK_OBJECTS			(20000)
+#define CHECK_QUERIES			(200)
+#define CHECK_NEAREST			(50)
+
+typedef MathMBR<double, 2>	MBR;
+
+/* Учет занятой динамической памяти для измерения пикового расхода при построении */
+static std::atomic<size_t>	allocatedBytes(0);
+static std::atomic<size_t>	peakBytes(0);
+
+/* Выделить учитываемый блок size байт с выравниванием alignment: размер блока и смещение начала выделенной памяти */
+/* хранятся непосредственно перед ним */
+static void* allocateCounted(size_t size, size_t alignment)
+{
+	const size_t	headerSize = std::max(alignment, alignof(std::max_align_t));
+	void			*block = nullptr;
+
+	if(posix_memalign(&block, headerSize, size + headerSize) != 0) throw std::bad_alloc();
+
+	size_t			*header = reinterpret_cast<size_t*>(static_cast<char*>(block) + headerSize);
+
+	header[-1] = size;
+	header[-2] = headerSize;
+
+	size_t			current = allocatedBytes += size;
+	size_t			peak = peakBytes;
+
+	while(current > peak && !peakBytes.compare_exchange_weak(peak, current));
+	return header;
+}
+
+/* не встраивается в operator delete: иначе GCC видит free() для указателя из operator new и выдает -Wmismatched-new-delete */
+static void deallocateCounted(void *pointer) noexcept __attribute__((noinline));
+
+static void deallocateCounted(void *pointer) noexcept
+{
+	if(pointer == nullptr) return;
+
+	size_t			*header = static_cast<size_t*>(pointer);
+
+	allocatedBytes -= header[-1];
+	free(static_cast<char*>(pointer) - header[-2]);
+}
+
+void* operator new(size_t size)
+{
+	return allocateCounted(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size)
+{
+	return allocateCounted(size, alignof(std::max_align_t));
+}
+
+/* размер для освобождения хранится в заголовке, переданный размер не нужен */
+void operator delete(void *pointer) noexcept
+{
+	deallocateCounted(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+	deallocateCounted(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+	deallocateCounted(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+	deallocateCounted(pointer);
+}
+
+#ifdef __cpp_aligned_new
+/* узлы дерева выровнены по строке кэша и с C++17 выделяются этими формами */
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return allocateCounted(size, size_t(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return allocateCounted(size, size_t(alignment));
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept
+{
+	deallocateCounted(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept
+{
+	deallocateCounted(pointer);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept
+{
+	deallocateCounted(pointer);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept
+{
+	deallocateCounted(pointer);
+}
+#endif
+
+/* Счетчик промахов последнего уровня кэша в текущем потоке через perf_event (только Linux) */
+class CacheMissCounter
+{
+public:
+	CacheMissCounter(): fd(-1)
+	{
+#ifdef __linux__
+		perf_event_attr		attributes;
+
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		fd = int(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+	}
+	~CacheMissCounter()
+	{
+#ifdef __linux__
+		if(fd >= 0) close(fd);
+#endif
+	}
+	bool							isAvailable() const {return fd >= 0;}
+	void							start()
+	{
+#ifdef __linux__
+		if(fd < 0) return;
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+	/* Число промахов с последнего вызова start() */
+	uint64_t						stop()
+	{
+		uint64_t		count = 0;
+
+#ifdef __linux__
+		if(fd < 0 || ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) != 0 || read(fd, &count, sizeof(count)) != sizeof(count)) return 0;
+#endif
+		return count;
+	}
+private:
+	int								fd;
+};
+
+class Triangle
+{
+public:
+	Triangle(const MathVector2D<double>& point1, const MathVector2D<double>& point2, const MathVector2D<double>& point3)
+	{
+		points[0] = point1;
+		points[1] = point2;
+		points[2] = point3;
+	}
+
+	const MathVector2D<double>&		point(uint8_t num) const {return points[num % 3];}
+
+	MBR								getMBR() const
+	{
+		MBR			mbr;
+
+		mbr.setDim(std::min(std::min(points[0].getX(), points[1].getX()), points[2].getX()), std::max(std::max(points[0].getX(), points[1].getX()), points[2].getX()), 0);
+		mbr.setDim(std::min(std::min(points[0].getY(), points[1].getY()), points[2].getY()), std::max(std::max(points[0].getY(), points[1].getY()), points[2].getY()), 1);
+
+		return mbr;
+	}
+private:
+	MathVector2D<double>			points[3];
+};
+
+typedef MathRTreeStar<Triangle, double, 2, 4, 10>	RTree;
+typedef MathFrozenRTreeStar<Triangle, double, 2, 10>	FrozenRTree;
+typedef MathRTreeStarLSM<Triangle, double, 2, 4, 10>	LSMRTree;
+
+/* Распределение положений треугольников */
+enum class Distribution
+{
+	Uniform,				/* равномерное по всей области */
+	Clustered,				/* нормальное вокруг NUM_CLUSTERS случайных центров */
+	Skewed					/* сгущение к углу области (MIN_X, MIN_Y) */
+};
+
+static std::vector<Triangle> generateTriangles(size_t numTriangles, Distribution distribution = Distribution::Uniform)
+{
+	std::default_random_engine				generator;
+	std::uniform_real_distribution<double>	xDistribution(MIN_X, MAX_X - MAX_SIZE);
+	std::uniform_real_distribution<double>	yDistribution(MIN_Y, MAX_Y - MAX_SIZE);
+	std::uniform_real_distribution<double>	deltaDistribution(0, MAX_SIZE);
+	std::uniform_real_distribution<double>	unitDistribution(0, 1);
+	std::normal_distribution<double>		clusterDistribution(0, (MAX_X - MIN_X) / 100.0);
+	std::vector<MathVector2D<double>>		centers;
+	std::vector<Triangle>					triangles;
+
+	for(size_t i = 0; i < NUM_CLUSTERS; i++)
+		centers.push_back(MathVector2D<double>(xDistribution(generator), yDistribution(generator)));
+	triangles.reserve(numTriangles);
+	for(size_t i = 0; i < numTriangles; i++)
+	{
+		double						x, y;
+
+		switch(distribution)
+		{
+		case Distribution::Uniform:
+			x = xDistribution(generator);
+			y = yDistribution(generator);
+			break;
+		case Distribution::Clustered:
+		{
+			const MathVector2D<double>	&center = centers[i % NUM_CLUSTERS];
+
+			x = std::min(std::max(center.getX() + clusterDistribution(generator), MIN_X), MAX_X - MAX_SIZE);
+			y = std::min(std::max(center.getY() + clusterDistribution(generator), MIN_Y), MAX_Y - MAX_SIZE);
+			break;
+		}
+		case Distribution::Skewed:
+			x = MIN_X + (MAX_X - MAX_SIZE - MIN_X) * std::pow(unitDistribution(generator), 4.0);
+			y = MIN_Y + (MAX_Y - MAX_SIZE - MIN_Y) * std::pow(unitDistribution(generator), 4.0);
+			break;
+		}
+		triangles.push_back(Triangle(MathVector2D<double>(x, y),
+									 MathVector2D<double>(x + deltaDistribution(generator), y + deltaDistribution(generator)),
+									 MathVector2D<double>(x + deltaDistribution(generator), y + deltaDistribution(generator))));
+	}
+	return triangles;
+}
+
+/* Окна запросов со сторонами до QUERY_SIZE с центрами в случайных объектах, чтобы плотность запросов следовала данным */
+static std::vector<MBR> generateQueries(const std::vector<Triangle>& triangles)
+{
+	std::default_random_engine				generator(1);
+	std::uniform_int_distribution<size_t>	indexDistribution(0, triangles.empty() ? 0 : triangles.size() - 1);
+	std::uniform_real_distribution<double>	sizeDistribution(0, QUERY_SIZE);
+	std::vector<MBR>						queries;
+
+	for(size_t i = 0; i < NUM_QUERIES && !triangles.empty(); i++)
+	{
+		const MathVector2D<double>	&point = triangles[indexDistribution(generator)].point(0);
+		double						width = sizeDistribution(generator), height = sizeDistribution(generator);
+		MBR							query;
+
+		query.setDim(point.getX() - width / 2, point.getX() + width / 2, 0);
+		query.setDim(point.getY() - height / 2, point.getY() + height / 2, 1);
+		queries.push_back(query);
+	}
+	return queries;
+}
+
+/* Число узлов в каждом уровне дерева - для сравнения структуры деревьев, построенных разным числом потоков */
+static std::vector<size_t> levelSizes(const RTree& rtree)
+{
+	std::vector<size_t>			sizes;
+
+	for(const RTree::Node *first = rtree.getTop(); first != nullptr;)
+	{
+		size_t		num = 0;
+
+		for(auto node = first; node != nullptr; node = RTree::nextInThisRow(node))
+			num++;
+		sizes.push_back(num);
+		first = first->isLeaf() ? nullptr : static_cast<const RTree::Node*>(first->childs[0]);
+	}
+	return sizes;
+}
+
+/* Суммарное попарное перекрытие MBR потомков по всем внутренним узлам */
+static double totalOverlap(const RTree& rtree)
+{
+	double			overlap = 0.0;
+
+	for(const RTree::Node *first = rtree.getTop(); first != nullptr && !first->isLeaf(); first = static_cast<const RTree::Node*>(first->childs[0]))
+		for(auto node = first; node != nullptr; node = RTree::nextInThisRow(node))
+			for(size_t i = 0; i < node->getNumChildren(); i++)
+				for(size_t j = i + 1; j < node->getNumChildren(); j++)
+					overlap += static_cast<const RTree::Node*>(node->childs[i])->getMBR().overlapVolume(static_cast<const RTree::Node*>(node->childs[j])->getMBR());
+	return overlap;
+}
+
+/* Построить дерево способом build и вывести строку сравнения: время, пиковая память, узлы, перекрытие, запросы */
+static void measure(const std::string& name, RTree& rtree, const std::vector<MBR>& queries, const std::function<void(RTree&)>& build)
+{
+	size_t			baseBytes = allocatedBytes;
+
+	peakBytes = baseBytes;
+
+	auto			start = std::chrono::steady_clock::now();
+
+	build(rtree);
+
+	double			buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double			peak = double(peakBytes - baseBytes) / 1048576.0;
+	size_t			numNodes = 0, numFound = 0;
+
+	for(auto num : levelSizes(rtree))
+		numNodes += num;
+	start = std::chrono::steady_clock::now();
+	for(auto& query : queries)
+		for(auto it = rtree.begin(query); it != rtree.end(); ++it)
+			numFound++;
+
+	double			queryTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::setw(14) << name << std::setw(10) << std::fixed << std::setprecision(3) << buildTime << std::setw(10) << std::setprecision(1) << peak
+			  << std::setw(10) << numNodes << std::setw(8) << rtree.levels() << std::setw(14) << std::setprecision(1) << totalOverlap(rtree)
+			  << std::setw(10) << std::setprecision(3) << queryTime << std::setw(12) << numFound << std::endl;
+}
+
+/* Сравнение способов построения на наборе triangles */
+static void compareBuilders(const std::string& name, const std::vector<Triangle>& triangles, size_t maxThreads)
+{
+	std::vector<MBR>		queries = generateQueries(triangles);
+	const char				*methodNames[] = {"STR", "Hilbert", "TopDown"};
+
+	std::cout << std::endl << name << ": " << triangles.size() << " objects, " << queries.size() << " queries" << std::endl;
+	std::cout << std::setw(14) << "method" << std::setw(10) << "build, s" << std::setw(10) << "peak, MB" << std::setw(10) << "nodes" << std::setw(8) << "levels"
+			  << std::setw(14) << "overlap" << std::setw(10) << "query, s" << std::setw(12) << "found" << std::endl;
+	{
+		RTree		rtree;
+
+		measure("insert", rtree, queries, [&triangles](RTree& rtree)
+		{
+			for(auto& triangle : triangles)
+				rtree.insert(triangle);
+		});
+		measure("rebuild", rtree, queries, [](RTree& rtree) {rtree.rebuild();});
+	}
+	{
+		RTree		rtree;
+
+		measure("insert_range", rtree, queries, [&triangles](RTree& rtree)
+		{
+			for(size_t i = 0; i < triangles.size(); i += INSERT_BATCH)
+				rtree.insert_range(triangles.begin() + i, triangles.begin() + std::min(i + INSERT_BATCH, triangles.size()));
+		});
+	}
+	{
+		RTree		rtree;
+
+		measure("external", rtree, queries, [&triangles](RTree& rtree)
+		{
+			rtree.assign_external(triangles.begin(), triangles.end(), EXTERNAL_TEMP_DIR, EXTERNAL_BUDGET);
+		});
+	}
+	for(size_t method = 0; method < 3; method++)
+		for(size_t numThreads = 1;; numThreads = maxThreads)
+		{
+			RTree		rtree;
+
+			measure(std::string(methodNames[method]) + (numThreads > 1 ? " x" + std::to_string(numThreads) : std::string()), rtree, queries,
+					[&triangles, method, numThreads](RTree& rtree) {rtree.assign(triangles.begin(), triangles.end(), RTree::PackingMethod(method), numThreads);});
+			if(numThreads == maxThreads) break;
+		}
+}
+
+/* Масштабирование массовой загрузки с числом потоков */
+static void compareThreads(const std::vector<Triangle>& triangles, size_t maxThreads)
+{
+	const char				*methodNames[] = {"STR", "Hilbert", "TopDown"};
+
+	std::cout << std::endl << "Scaling: " << triangles.size() << " objects, max threads: " << maxThreads << std::endl;
+	std::cout << std::setw(10) << "method" << std::setw(10) << "threads" << std::setw(12) << "time, s" << std::setw(10) << "speedup" << std::setw(12) << "structure" << std::endl;
+	for(size_t method = 0; method < 3; method++)
+	{
+		double					sequentialTime = 0.0;
+		std::vector<size_t>		sequentialSizes;
+
+		for(size_t numThreads = 1; numThreads <= maxThreads; numThreads = std::min(numThreads * 2, maxThreads))
+		{
+			RTree		rtree;
+			auto		start = std::chrono::steady_clock::now();
+
+			rtree.assign(triangles.begin(), triangles.end(), RTree::PackingMethod(method), numThreads);
+
+			double		time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if(numThreads == 1)
+			{
+				sequentialTime = time;
+				sequentialSizes = levelSizes(rtree);
+			}
+			std::cout << std::setw(10) << methodNames[method] << std::setw(10) << numThreads << std::setw(12) << std::fixed << std::setprecision(3) << time
+					  << std::setw(10) << std::setprecision(2) << sequentialTime / time << std::setw(12) << (levelSizes(rtree) == sequentialSizes ? "same" : "DIFFERENT") << std::endl;
+			if(numThreads == maxThreads) break;
+		}
+	}
+}
+
+/* Время проверки потомков одного узла способом test, усредненное по узлам nodes и окнам queries */
+template <class ChildTest>
+static void measureChildTest(const std::string& name, const std::vector<const RTree::Node*>& nodes, const std::vector<MBR>& queries, ChildTest test)
+{
+	size_t			numFound = 0, numTests = 0;
+	auto			start = std::chrono::steady_clock::now();
+
+	for(size_t i = 0; i < queries.size(); i++)
+		for(size_t j = i % 16; j < nodes.size(); j += 16, numTests++)
+			numFound += test(nodes[j], queries[i]);
+
+	double			time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::setw(10) << name << std::setw(12) << std::fixed << std::setprecision(2) << time * 1e9 / double(std::max<size_t>(1, numTests))
+			  << std::setw(12) << numFound << std::endl;
+}
+
+/* Стоимость проверки потомков внутреннего узла окном запроса: по MBR в самих потомках, по копии границ в узле */
+/* поэлементно и векторным ядром */
+static void compareChildTests(const std::vector<Triangle>& triangles)
+{
+	RTree								rtree(triangles.begin(), triangles.end(), RTree::PackingMethod::Hilbert);
+	std::vector<MBR>					queries = generateQueries(triangles);
+	std::vector<const RTree::Node*>		nodes;
+
+	for(const RTree::Node *first = rtree.getTop(); first != nullptr && !first->isLeaf(); first = static_cast<const RTree::Node*>(first->childs[0]))
+		for(auto node = first; node != nullptr; node = RTree::nextInThisRow(node))
+			nodes.push_back(node);
+	std::cout << std::endl << "Child tests: " << nodes.size() << " internal nodes, " << queries.size() << " queries, kernels: "
+			  << MathRTreeStarKernels<double, 2, 10>::instructionSet() << std::endl;
+	std::cout << std::setw(10) << "test" << std::setw(12) << "ns/node" << std::setw(12) << "found" << std::endl;
+	measureChildTest("MathMBR", nodes, queries, [](const RTree::Node *node, const MBR& query)
+	{
+		size_t		num = 0;
+
+		for(size_t i = 0; i < node->getNumChildren(); i++)
+			num += static_cast<const RTree::Node*>(node->childs[i])->getMBR().isIntersect(query);
+		return num;
+	});
+	measureChildTest("inline", nodes, queries, [](const RTree::Node *node, const MBR& query)
+	{
+		size_t		num = 0;
+
+		for(size_t i = 0; i < node->getNumChildren(); i++)
+			num += node->getChildMBR(i).isIntersect(query);
+		return num;
+	});
+	measureChildTest("kernel", nodes, queries, [](const RTree::Node *node, const MBR& query)
+	{
+		size_t		num = 0;
+
+		for(uint64_t mask = node->getIntersectMask(0, query); mask != 0; mask &= mask - 1)
+			num++;
+		return num;
+	});
+}
+
+/* Время queries поисков способом search и число найденных элементов */
+template <class Search>
+static void measureSearch(const std::string& name, size_t bytes, const std::vector<MBR>& queries, Search search)
+{
+	size_t			numFound = 0;
+	auto			start = std::chrono::steady_clock::now();
+
+	for(auto& query : queries)
+		numFound += search(query);
+
+	double			time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::setw(14) << name << std::setw(12) << std::fixed << std::setprecision(1) << double(bytes) / 1048576.0
+			  << std::setw(12) << std::setprecision(2) << time * 1e6 / double(std::max<size_t>(1, queries.size())) << std::setw(12) << numFound << std::endl;
+}
+
+/* Поиск по упакованному дереву и его замороженной копии: память, задержка окна и ближайших соседей */
+static void compareFrozen(const std::vector<Triangle>& triangles)
+{
+	std::vector<MBR>		queries = generateQueries(triangles);
+	size_t					baseBytes = allocatedBytes;
+	RTree					rtree(triangles.begin(), triangles.end(), RTree::PackingMethod::Hilbert);
+	size_t					rtreeBytes = allocatedBytes - baseBytes;
+
+	baseBytes = allocatedBytes;
+
+	FrozenRTree				frozen(rtree);
+	size_t					frozenBytes = allocatedBytes - baseBytes;
+
+	std::cout << std::endl << "Frozen: " << triangles.size() << " objects, " << queries.size() << " queries" << std::endl;
+	std::cout << std::setw(14) << "search" << std::setw(12) << "memory, MB" << std::setw(12) << "us/query" << std::setw(12) << "found" << std::endl;
+	measureSearch("iterator", rtreeBytes, queries, [&rtree](const MBR& query)
+	{
+		size_t		num = 0;
+
+		for(auto it = rtree.begin(query); it != rtree.end(); ++it)
+			num++;
+		return num;
+	});
+	measureSearch("frozen it", frozenBytes, queries, [&frozen](const MBR& query)
+	{
+		size_t		num = 0;
+
+		for(auto it = frozen.begin(query); it != frozen.end(); ++it)
+			num++;
+		return num;
+	});
+	measureSearch("frozen query", frozenBytes, queries, [&frozen](const MBR& query)
+	{
+		size_t		num = 0;
+
+		frozen.query(query, [&num](const Triangle&) {num++;});
+		return num;
+	});
+	measureSearch("frozen 10-NN", frozenBytes, queries, [&frozen](const MBR& query) {return frozen.nearest(query, 10).size();});
+}
+
+/* Поиск по окнам: итераторы с предикатами std::function и с предикатами-параметрами шаблона, query с visitor */
+static void compareQueryApi(const std::vector<Triangle>& triangles)
+{
+	std::vector<MBR>		queries = generateQueries(triangles);
+	size_t					baseBytes = allocatedBytes;
+	RTree					rtree(triangles.begin(), triangles.end(), RTree::PackingMethod::Hilbert);
+	size_t					rtreeBytes = allocatedBytes - baseBytes;
+
+	std::cout << std::endl << "Query API: " << triangles.size() << " objects, " << queries.size() << " queries" << std::endl;
+	std::cout << std::setw(14) << "search" << std::setw(12) << "memory, MB" << std::setw(12) << "us/query" << std::setw(12) << "found" << std::endl;
+	measureSearch("std::function", rtreeBytes, queries, [&rtree](const MBR& query)
+	{
+		size_t		num = 0;
+
+		for(auto it = rtree.begin([&query](const MBR& mbr) {return mbr.isIntersect(query);}, [&query](const MBR& mbr) {return mbr.isIntersect(query);});
+			it != rtree.end(); ++it)
+			num++;
+		return num;
+	});
+	measureSearch("begin_query", rtreeBytes, queries, [&rtree](const MBR& query)
+	{
+		size_t		num = 0;
+
+		for(auto it = rtree.begin_query([&query](const MBR& mbr) {return mbr.isIntersect(query);}, [&query](const MBR& mbr) {return mbr.isIntersect(query);});
+			it != rtree.end(); ++it)
+			num++;
+		return num;
+	});
+	measureSearch("query pred", rtreeBytes, queries, [&rtree](const MBR& query)
+	{
+		size_t		num = 0;
+
+		rtree.query([&query](const MBR& mbr) {return mbr.isIntersect(query);}, [&query](const MBR& mbr) {return mbr.isIntersect(query);},
+					[&num](const Triangle&) {num++;});
+		return num;
+	});
+	measureSearch("region it", rtreeBytes, queries, [&rtree](const MBR& query)
+	{
+		size_t		num = 0;
+
+		for(auto it = rtree.begin(query); it != rtree.end(); ++it)
+			num++;
+		return num;
+	});
+	measureSearch("query region", rtreeBytes, queries, [&rtree](const MBR& query)
+	{
+		size_t		num = 0;
+
+		rtree.query(query, [&num](const Triangle&) {num++;});
+		return num;
+	});
+	measureSearch("10-NN", rtreeBytes, queries, [&rtree](const MBR& query) {return rtree.nearest(query, 10).size();});
+	/* перебор по удалению до 10 треугольников, у которых первая вершина левее второй: дерево раскрывается по мере надобности */
+	measureSearch("browse 10", rtreeBytes, queries, [&rtree](const MBR& query)
+	{
+		size_t		num = 0;
+
+		for(auto it = rtree.cbegin_nearest(query); it != rtree.cend() && num < 10; ++it)
+			if(it->point(0).getX() < it->point(1).getX()) num++;
+		return num;
+	});
+}
+
+/* Окна просмотра с центрами в случайных объектах, разбитые на TILES_PER_SIDE x TILES_PER_SIDE плиток со стороной QUERY_SIZE: */
+/* плитки одного окна идут подряд */
+static std::vector<MBR> generateTiles(const std::vector<Triangle>& triangles)
+{
+	std::vector<MBR>		queries = generateQueries(triangles);
+	std::vector<MBR>		tiles;
+	double					half = TILES_PER_SIDE * QUERY_SIZE / 2;
+
+	for(size_t i = 0; i < queries.size() / (TILES_PER_SIDE * TILES_PER_SIDE); i++)
+	{
+		double				x = (queries[i].minDim(0) + queries[i].maxDim(0)) / 2 - half, y = (queries[i].minDim(1) + queries[i].maxDim(1)) / 2 - half;
+
+		for(size_t row = 0; row < TILES_PER_SIDE; row++)
+			for(size_t column = 0; column < TILES_PER_SIDE; column++)
+			{
+				MBR			tile;
+
+				tile.setDim(x + column * QUERY_SIZE, x + (column + 1) * QUERY_SIZE, 0);
+				tile.setDim(y + row * QUERY_SIZE, y + (row + 1) * QUERY_SIZE, 1);
+				tiles.push_back(tile);
+			}
+	}
+	return tiles;
+}
+
+/* Пакеты по batchSize окон: один обход дерева на пакет против обхода на каждое окно */
+static void measureBatch(const std::string& name, const RTree& rtree, const std::vector<MBR>& queries, size_t batchSize)
+{
+	size_t			numFound = 0;
+	auto			start = std::chrono::steady_clock::now();
+
+	for(size_t first = 0; first < queries.size(); first += batchSize)
+		rtree.query_batch(queries.data() + first, std::min(batchSize, queries.size() - first), [&numFound](size_t, const Triangle&) {numFound++;});
+
+	double			time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::setw(14) << name << std::setw(12) << std::fixed << std::setprecision(2) << time * 1e6 / double(std::max<size_t>(1, queries.size()))
+			  << std::setw(12) << numFound << std::endl;
+}
+
+/* Пакетный поиск: плитки окон просмотра и случайные окна, по одному и пакетами */
+static void compareBatch(const std::vector<Triangle>& triangles)
+{
+	std::vector<MBR>		tiles = generateTiles(triangles);
+	std::vector<MBR>		queries = generateQueries(triangles);
+	RTree					rtree(triangles.begin(), triangles.end(), RTree::PackingMethod::Hilbert);
+
+	std::cout << std::endl << "Batch: " << triangles.size() << " objects, " << tiles.size() << " tiles, " << queries.size() << " queries" << std::endl;
+	std::cout << std::setw(14) << "search" << std::setw(12) << "us/query" << std::setw(12) << "found" << std::endl;
+	measureBatch("tiles x1", rtree, tiles, 1);
+	measureBatch("tiles x256", rtree, tiles, TILES_PER_SIDE * TILES_PER_SIDE);
+	measureBatch("random x1", rtree, queries, 1);
+	measureBatch("random x64", rtree, queries, 64);
+	measureBatch("random x1024", rtree, queries, 1024);
+}
+
+/* Строка сравнения двухуровневого индекса: время на операцию, число операций, их результат, размеры базы и изменений */
+static void printLSM(const std::string& name, double time, size_t numOps, size_t result, const LSMRTree& lsm)
+{
+	std::cout << std::setw(14) << name << std::setw(12) << std::fixed << std::setprecision(2) << time * 1e6 / double(std::max<size_t>(1, numOps))
+			  << std::setw(10) << numOps << std::setw(10) << result << std::setw(10) << lsm.getBase().size() << std::setw(10) << lsm.getDelta().size() << std::endl;
+}
+
+/* Двухуровневый индекс: поток вставок и удалений из базы с фоновыми слияниями, поиск во время слияния и после него */
+static void compareLSM(const std::vector<Triangle>& triangles)
+{
+	std::vector<MBR>		queries = generateQueries(triangles);
+	std::vector<Triangle>	inserted = generateTriangles(std::min<size_t>(triangles.size(), INSERT_BATCH), Distribution::Clustered);
+	size_t					numErases = inserted.size() / 10, numErased = 0, numFound = 0;
+	LSMRTree				lsm;
+
+	std::cout << std::endl << "LSM: " << triangles.size() << " objects, " << inserted.size() << " inserts, " << numErases << " erases, "
+			  << queries.size() << " queries" << std::endl;
+	std::cout << std::setw(14) << "operation" << std::setw(12) << "us/op" << std::setw(10) << "ops" << std::setw(10) << "result"
+			  << std::setw(10) << "base" << std::setw(10) << "delta" << std::endl;
+
+	auto					start = std::chrono::steady_clock::now();
+
+	lsm.assign(triangles.begin(), triangles.end());
+	printLSM("assign", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), triangles.size(), lsm.size(), lsm);
+	start = std::chrono::steady_clock::now();
+	for(auto& triangle : inserted)
+		lsm.insert(triangle);
+	printLSM("insert", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), inserted.size(), lsm.size(), lsm);
+	/* удаляемый элемент базы находится поиском по его MBR, время поиска входит в удаление */
+	start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < numErases && !triangles.empty(); i++)
+	{
+		MBR					mbr = triangles[i * triangles.size() / numErases].getMBR();
+		const Triangle		*found = nullptr;
+
+		/* erase может заменить базу, поэтому итератор завершается до удаления */
+		for(auto it = lsm.begin(mbr); it != lsm.end() && found == nullptr; ++it)
+			if(it->getMBR() == mbr) found = &*it;
+		if(found != nullptr && lsm.erase(*found)) numErased++;
+	}
+	printLSM("erase", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), numErases, numErased, lsm);
+	start = std::chrono::steady_clock::now();
+	for(auto& query : queries)
+		for(auto it = lsm.begin(query); it != lsm.end(); ++it)
+			numFound++;
+	printLSM(lsm.merging() ? "query merging" : "query", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), queries.size(), numFound, lsm);
+	start = std::chrono::steady_clock::now();
+	lsm.merge();
+	lsm.wait();
+	printLSM("merge", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1, lsm.size(), lsm);
+	numFound = 0;
+	start = std::chrono::steady_clock::now();
+	for(auto& query : queries)
+		for(auto it = lsm.begin(query); it != lsm.end(); ++it)
+			numFound++;
+	printLSM("query merged", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), queries.size(), numFound, lsm);
+}
+
+/* Расход памяти дерева по уровням от корня к листьям */
+static void printMemoryUsage(const std::string& name, const RTree& rtree)
+{
+	RTree::MemoryUsage		usage = rtree.memory_usage();
+
+	std::cout << name << ": internal " << std::fixed << std::setprecision(1) << double(usage.internalBytes) / 1048576.0 << " MB, leaves "
+			  << double(usage.leafBytes) / 1048576.0 << " MB, data " << double(usage.dataBytes) / 1048576.0 << " MB, reserved "
+			  << double(usage.reservedBytes) / 1048576.0 << " MB, fill " << std::setprecision(3) << usage.fill << std::endl;
+	std::cout << std::setw(10) << "level" << std::setw(12) << "nodes" << std::setw(12) << "children" << std::setw(12) << "MB" << std::setw(10) << "fill" << std::endl;
+	for(size_t i = 0; i < usage.levels.size(); i++)
+		std::cout << std::setw(10) << i << std::setw(12) << usage.levels[i].numNodes << std::setw(12) << usage.levels[i].numChildren << std::setw(12)
+				  << std::setprecision(2) << double(usage.levels[i].bytes) / 1048576.0 << std::setw(10) << std::setprecision(3) << usage.levels[i].fill << std::endl;
+}
+
+/* Расход памяти дерева, построенного вставками, и упакованного дерева */
+static void compareMemory(const std::vector<Triangle>& triangles)
+{
+	std::cout << std::endl << "Memory: " << triangles.size() << " objects" << std::endl;
+	{
+		RTree		rtree;
+
+		for(auto& triangle : triangles)
+			rtree.insert(triangle);
+		printMemoryUsage("insert", rtree);
+	}
+	{
+		RTree		rtree(triangles.begin(), triangles.end(), RTree::PackingMethod::STR);
+
+		printMemoryUsage("STR", rtree);
+	}
+}
+
+/* Промахи кэша и время обхода при поиске по окнам и выборе листа при вставке */
+static void measureTraversal(const std::string& name, RTree& rtree, const std::vector<Triangle>& inserted, const std::vector<MBR>& queries)
+{
+	CacheMissCounter		counter;
+	size_t					numFound = 0;
+
+	counter.start();
+
+	auto					start = std::chrono::steady_clock::now();
+
+	for(auto& query : queries)
+		for(auto it = rtree.begin(query); it != rtree.end(); ++it)
+			numFound++;
+
+	double					queryTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	uint64_t				queryMisses = counter.stop();
+
+	counter.start();
+	start = std::chrono::steady_clock::now();
+	for(auto& triangle : inserted)
+		rtree.insert(triangle);
+
+	double					insertTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	uint64_t				insertMisses = counter.stop();
+
+	std::cout << std::setw(10) << name << std::setw(12) << std::fixed << std::setprecision(2) << queryTime * 1e6 / double(std::max<size_t>(1, queries.size()));
+	if(counter.isAvailable())
+		std::cout << std::setw(12) << std::setprecision(1) << double(queryMisses) / double(std::max<size_t>(1, queries.size()));
+	else
+		std::cout << std::setw(12) << "n/a";
+	std::cout << std::setw(12) << std::setprecision(2) << insertTime * 1e6 / double(std::max<size_t>(1, inserted.size()));
+	if(counter.isAvailable())
+		std::cout << std::setw(12) << std::setprecision(1) << double(insertMisses) / double(std::max<size_t>(1, inserted.size()));
+	else
+		std::cout << std::setw(12) << "n/a";
+	std::cout << std::setw(12) << numFound << std::endl;
+}
+
+/* Обход дерева, построенного вставками (узлы разбросаны по памяти) и упаковкой. Для сравнения с программной */
+/* предвыборкой и без нее бенчмарк собирается дважды: как есть и с DEFINES += MATH_RTREE_STAR_NO_PREFETCH */
+static void compareTraversal(const std::vector<Triangle>& triangles)
+{
+	std::vector<MBR>		queries = generateQueries(triangles);
+	std::vector<Triangle>	inserted = generateTriangles(std::min<size_t>(triangles.size(), INSERT_BATCH), Distribution::Clustered);
+
+	std::cout << std::endl << "Traversal: " << triangles.size() << " objects, " << queries.size() << " queries, " << inserted.size() << " inserts, node "
+			  << sizeof(RTree::Node) << " bytes aligned to " << alignof(RTree::Node) << ", prefetch "
+#ifdef MATH_RTREE_STAR_NO_PREFETCH
+			  << "off" << std::endl;
+#else
+			  << "on" << std::endl;
+#endif
+	std::cout << std::setw(10) << "tree" << std::setw(12) << "us/query" << std::setw(12) << "LLC/query" << std::setw(12) << "us/insert"
+			  << std::setw(12) << "LLC/insert" << std::setw(12) << "found" << std::endl;
+	{
+		RTree		rtree;
+
+		for(auto& triangle : triangles)
+			rtree.insert(triangle);
+		measureTraversal("insert", rtree, inserted, queries);
+	}
+	{
+		RTree		rtree(triangles.begin(), triangles.end(), RTree::PackingMethod::Hilbert);
+
+		measureTraversal("Hilbert", rtree, inserted, queries);
+	}
+}
+
+/* Строка сверки с полным перебором: число проверок и расхождений */
+static bool reportCheck(const std::string& name, size_t numChecks, size_t numErrors)
+{
+	std::cout << std::setw(14) << name << std::setw(10) << numChecks << std::setw(10) << numErrors << std::endl;
+	return numErrors == 0;
+}
+
+/* Сверка с полным перебором на CHECK_OBJECTS объектах: расстояния nearest и begin_nearest по порядку, query_batch */
+/* на CHECK_QUERIES окнах (больше 64 - несколько слов маски), поиск и перебор всех элементов после splice */
+static bool crossCheck(const std::vector<Triangle>& objects)
+{
+	std::vector<Triangle>	triangles(objects.begin(), objects.begin() + std::min<size_t>(objects.size(), CHECK_OBJECTS));
+	std::vector<MBR>		queries = generateQueries(triangles);
+	std::vector<size_t>		expected;
+	RTree					rtree(triangles.begin(), triangles.end(), RTree::PackingMethod::Hilbert);
+	size_t					numNearestErrors = 0, numBrowseErrors = 0, numBatchErrors = 0, numSpliceErrors = 0;
+	bool					isCorrect = true;
+
+	queries.resize(std::min<size_t>(queries.size(), CHECK_QUERIES));
+	std::cout << std::endl << "Cross-check: " << triangles.size() << " objects, " << queries.size() << " queries" << std::endl;
+	std::cout << std::setw(14) << "check" << std::setw(10) << "checks" << std::setw(10) << "errors" << std::endl;
+	/* при равных расстояниях порядок элементов не определен, поэтому по порядку сравниваются расстояния */
+	for(auto& query : queries)
+	{
+		std::vector<double>		distances;
+		size_t					numFound = 0, num = 0;
+
+		for(auto& triangle : triangles)
+		{
+			distances.push_back(triangle.getMBR().minDistance(query));
+			if(triangle.getMBR().isIntersect(query)) numFound++;
+		}
+		expected.push_back(numFound);
+		std::sort(distances.begin(), distances.end());
+		distances.resize(std::min<size_t>(distances.size(), CHECK_NEAREST));
+
+		std::vector<Triangle*>	nearest = rtree.nearest(query, CHECK_NEAREST);
+
+		if(nearest.size() != distances.size()) numNearestErrors++;
+		for(size_t i = 0; i < std::min(nearest.size(), distances.size()); i++)
+			if(nearest[i]->getMBR().minDistance(query) != distances[i]) numNearestErrors++;
+		for(auto it = rtree.cbegin_nearest(query); it != rtree.cend() && num < distances.size(); ++it, num++)
+			if(it.getDistance() != distances[num] || it->getMBR().minDistance(query) != distances[num]) numBrowseErrors++;
+		if(num != distances.size()) numBrowseErrors++;
+	}
+	isCorrect &= reportCheck("nearest", queries.size(), numNearestErrors);
+	isCorrect &= reportCheck("browse", queries.size(), numBrowseErrors);
+
+	std::vector<size_t>		found(queries.size(), 0);
+
+	rtree.query_batch(queries.data(), queries.size(), [&found](size_t num, const Triangle&) {found[num]++;});
+	for(size_t i = 0; i < queries.size(); i++)
+		if(found[i] != expected[i]) numBatchErrors++;
+	isCorrect &= reportCheck("query_batch", queries.size(), numBatchErrors);
+
+	/* к дереву, построенному вставками, присоединяется упакованное из второй половины объектов */
+	RTree					first, second(triangles.begin() + triangles.size() / 2, triangles.end(), RTree::PackingMethod::STR);
+	size_t					numElements = 0;
+
+	for(size_t i = 0; i < triangles.size() / 2; i++)
+		first.insert(triangles[i]);
+	first.splice(second);
+	for(auto it = first.begin(); it != first.end(); ++it)
+		numElements++;
+	if(first.size() != triangles.size() || numElements != triangles.size() || second.size() != 0) numSpliceErrors++;
+	for(size_t i = 0; i < queries.size(); i++)
+	{
+		size_t		numFound = 0;
+
+		for(auto it = first.begin(queries[i]); it != first.end(); ++it)
+			numFound++;
+		if(numFound != expected[i]) numSpliceErrors++;
+	}
+	isCorrect &= reportCheck("splice", queries.size() + 1, numSpliceErrors);
+	return isCorrect;
+}
+
+/* RTreeBench [число объектов] [максимальное число потоков] */
+int main(int argc, char *argv[])
+{
+	size_t					numTriangles = argc > 1 ? strtoul(argv[1], nullptr, 10) : NUM_TRIANGLES;
+	size_t					maxThreads = argc > 2 ? strtoul(argv[2], nullptr, 10) : std::max<unsigned>(1, std::thread::hardware_concurrency());
+
+	maxThreads = std::max<size_t>(1, maxThreads);
+	/* при расхождении с полным перебором замеры не имеют смысла */
+	if(!crossCheck(generateTriangles(numTriangles))) return 1;
+	compareBuilders("Uniform", generateTriangles(numTriangles, Distribution::Uniform), maxThreads);
+	compareBuilders("Clustered", generateTriangles(numTriangles, Distribution::Clustered), maxThreads);
+	compareBuilders("Skewed", generateTriangles(numTriangles, Distribution::Skewed), maxThreads);
+	compareThreads(generateTriangles(numTriangles), maxThreads);
+	compareChildTests(generateTriangles(numTriangles));
+	compareFrozen(generateTriangles(numTriangles));
+	compareQueryApi(generateTriangles(numTriangles));
+	compareBatch(generateTriangles(numTriangles));
+	compareLSM(generateTriangles(numTriangles));
+	compareTraversal(generateTriangles(numTriangles));
+	compareMemory(generateTriangles(numTriangles));
+
+	return 0;
+}